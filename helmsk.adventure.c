@@ -5,30 +5,45 @@
  *
  * Overview:
  * This program uses rooms from helmsk.buildrooms files to
- * run a command line maze game.
+ * run a command line maze game. Run with --validate to
+ * check room directories instead of playing.
  ************************************************************/
 
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <dirent.h>
 #include <pthread.h>
+#include <sched.h>
 #include <assert.h>
+#include <limits.h>
 
 #define MIN_CONNECTIONS 3
 #define MAX_CONNECTIONS 6
-#define ROOMS_IN_GAME 7
+#define MAX_ROOMS 10    //one room per prepicked room name
+#define MAX_READERS 16    //threads that can hold a maze snapshot at once
+#define MAX_STEPS 50
+#define MAX_NAME 30    //room names have to fit the 30 char input buffer
+#define MAX_FILE_SIZE 4096    //biggest room file the validator will read
+#define MAX_WORKERS 64    //most validator threads
+#define STRESS_WRITERS 4    //writer threads in the stress check
+#define STRESS_WAVES 4    //rounds of reader threads in the stress check
+#define STRESS_EDITS 5000    //edits each stress writer makes
+#define STRESS_READS 2000    //snapshots each stress reader checks
 
 
 /* ************************************************************************
 	                  Global Variables
  ************************************************************************ */
 
-pthread_mutex_t myMutex = PTHREAD_MUTEX_INITIALIZER;    //mutex lock
+pthread_mutex_t myMutex = PTHREAD_MUTEX_INITIALIZER;    //mutex lock for the time thread handoff
 
 const char *roomNames[] = {    //prepicked room names based on Seattle neighborhoods and landscapes!
         "DennyDen",
@@ -52,6 +67,62 @@ struct Room {
     int currConnections;    //counts connected rooms as they are added
 };
 
+struct Maze {
+    unsigned long version;    //bumped every time a writer publishes a change
+    int numRooms;    //number of rooms in this snapshot
+    struct Room *rooms[MAX_ROOMS];    //rooms, connections point at rooms in the same snapshot
+};
+
+struct ReaderSlot {
+    int inUse;    //set once a thread claims the slot
+    unsigned long epoch;    //epoch the thread entered at, 0 when not reading
+};
+
+struct RetiredMaze {
+    struct Maze *maze;    //old snapshot waiting to be freed
+    unsigned long epoch;    //epoch it was replaced in
+    struct RetiredMaze *next;
+};
+
+struct RoomCheck {
+    char file[256];    //file the room was read from
+    char name[MAX_NAME];    //room name
+    int nameLine;    //line the room name is on
+    char type[MAX_NAME];    //room type
+    int typeLine;    //line the room type is on
+    char connections[MAX_CONNECTIONS][MAX_NAME];    //connecting room names
+    int connectionLines[MAX_CONNECTIONS];    //line each connection is on
+    int numConnections;    //connections listed, even past MAX_CONNECTIONS
+};
+
+struct Report {
+    char *text;    //violation messages for one maze
+    size_t length;    //characters used
+    size_t size;    //characters allocated
+    int violations;    //number of messages
+    int checked;    //set once the maze has been validated
+};
+
+struct ValidateJob {
+    char **dirs;    //maze directories to check
+    int numDirs;
+    int next;    //next directory to hand out, taken atomically
+    struct Report *reports;    //one report per directory
+};
+
+struct Maze *currentMaze = NULL;    //published snapshot, only ever swapped atomically
+unsigned long globalEpoch = 1;    //advanced by writers after each publish
+struct ReaderSlot readerSlots[MAX_READERS];    //one slot per reading thread
+struct RetiredMaze *retiredMazes = NULL;    //snapshots replaced but maybe still being read
+__thread int readerSlot = -1;    //this thread's index into readerSlots
+__thread int readerDepth = 0;    //how many mazeEnters this thread is inside
+pthread_key_t readerKey;    //gives the slot back when the thread exits
+pthread_once_t readerKeyOnce = PTHREAD_ONCE_INIT;
+unsigned long mazeRetries = 0;    //edits redone because another writer published first
+unsigned long mazeReclaims = 0;    //retired snapshots freed
+int stressErrors = 0;    //bad snapshots seen by the stress check
+char controlPath[PATH_MAX];    //fifo mazeControl reads commands from
+
 
 /* ************************************************************************
 	                 Function Prototypes
@@ -59,9 +130,49 @@ struct Room {
 
 void *displayTime(void *arg);
 void selectDirectory();
-void readMaze(struct Room **);
+int isRoomFile(const char *filename);
+void readMaze();
 struct Room *readFile(const char *filename);
-void play(struct Room **rooms);
+void makeReaderKey();
+void releaseReaderSlot(void *slot);
+void mazeEnter();
+void mazeExit();
+struct Maze *mazeSnapshot();
+struct Room *findRoom(struct Maze *maze, const char *name);
+char *copyString(const char *input);
+struct Maze *cloneMaze(struct Maze *old);
+void freeRoom(struct Room *room);
+void freeMaze(struct Maze *maze);
+void reclaimMazes();
+void retireMaze(struct Maze *maze);
+int goodRoomName(const char *name);
+int mazePlayable(struct Maze *old, struct Maze *maze);
+int editMaze(int (*edit)(struct Maze *, const char *, const char *), const char *a, const char *b);
+int connectRooms(struct Maze *maze, const char *from, const char *to);
+int unlinkRoom(struct Room *a, struct Room *b);
+int disconnectRooms(struct Maze *maze, const char *from, const char *to);
+int insertRoom(struct Maze *maze, const char *name, const char *unused);
+int deleteRoom(struct Maze *maze, const char *name, const char *unused);
+int mazeAddConnection(const char *from, const char *to);
+int mazeRemoveConnection(const char *from, const char *to);
+int mazeAddRoom(const char *name);
+int mazeRemoveRoom(const char *name);
+int isEndRoom(const char *name);
+void play();
+int createControl();
+void *mazeControl(void *arg);
+int checkSnapshot(struct Maze *maze);
+void *stressWriter(void *arg);
+void *stressReader(void *arg);
+int stressMaze();
+void report(struct Report *result, const char *format, ...);
+const char *readName(const char *text, char *name);
+void checkRoomFile(const char *dir, int dirFd, const char *filename, struct RoomCheck *room, struct Report *result);
+int findCheckedRoom(struct RoomCheck *rooms, int numRooms, const char *name);
+void validateMaze(const char *dir, struct Report *result);
+void *validateWorker(void *arg);
+int compareNames(const void *a, const void *b);
+int validate(int numDirs, char **dirs);
 
 
 /* ************************************************************************
@@ -71,18 +182,32 @@ void play(struct Room **rooms);
 /***********************************************************
  * main: calls functions to play maze game.
  *
- * parameters: none.
+ * parameters: argument count, arguments.
  * returns: exit int.
  ***********************************************************/
 
-int main() {
-    struct Room *roomArray[ROOMS_IN_GAME];    //array that holds rooms
+int main(int argc, char *argv[]) {
+    pthread_t controlThread;    //takes maze changes while playing
+    int control;    //whether the control fifo exists
+
+    if (argc > 1 && strcmp(argv[1], "--validate") == 0)    //check mazes instead of playing
+        return validate(argc - 2, argv + 2);
+    if (argc > 1 && strcmp(argv[1], "--stress") == 0)    //check live maze changes under load
+        return stressMaze();
+
+    control = createControl();    //before changing directory, so room directories keep their times
 
     selectDirectory();    //select most recent directory
 
-    readMaze(roomArray);    //read in room maze information
+    readMaze();    //read in room maze information and publish it
 
-    play(roomArray);    //play!
+    if (control && pthread_create(&controlThread, NULL, mazeControl, NULL) == 0)    //let the maze be reshaped during play
+        pthread_detach(controlThread);
+
+    play();    //play!
+
+    if (control)
+        unlink(controlPath);    //remove the control fifo
 
     return 0;    //success!
 }
@@ -235,34 +360,72 @@ void selectDirectory() {
 
 
 /***********************************************************
- * readMaze: opens each room file and stores the information
- * into a struct room array for game play.
+ * isRoomFile: decides which directory entries the game
+ * loads as rooms. the validator uses it too so it checks
+ * exactly what the game would load.
+ *
+ * parameters: c-string.
+ * returns: 1 if the game loads it, 0 otherwise.
+ ***********************************************************/
+
+int isRoomFile(const char *filename) {
+    return filename[0] != '.' &&    //if it starts with '.' it's a directory going back. don't open
+           filename[0] != 'c';    //if it starts with 'c' it's the currentTime.txt from a previous run. don't open
+}
+
+
+/***********************************************************
+ * readMaze: opens each room file, links the connections
+ * between the rooms, and publishes the result as the first
+ * maze snapshot.
  *
- * parameters: struct Room array.
+ * parameters: none.
  * returns: none.
  ***********************************************************/
 
-void readMaze(struct Room **rooms) {
+void readMaze() {
     DIR *d;
     struct dirent *dir;
     d = opendir(".");    //open current directory (now in most recent room directory)
-    int index = 0;
     const char *filename;
+    struct Maze *maze = malloc(sizeof(struct Maze));    //first snapshot
+    int i, j;
 
+    maze->version = 1;
+    maze->numRooms = 0;
 
     if (d) {    //if it opens
         /*reads files in directory until null is incountered*/
         while ((dir = readdir(d)) != NULL) {    //check all files
-            if (dir->d_name[0] != '.' &&    //if it starts with '.' it's a directory going back. don't open
-                dir->d_name[0] != 'c')    //if it starts with 'c' it's the currentTime.txt from a previous run. don't open
+            if (isRoomFile(dir->d_name) &&    //only open what the game treats as rooms
+                maze->numRooms < MAX_ROOMS)    //don't overrun the room array
             {
                 filename = dir->d_name;    //sets filename to the filename currently being read in directory
-                rooms[index] = readFile(filename);    //calls read file and puts returned struct in array
-                index++;    //updates index counter
+                maze->rooms[maze->numRooms] = readFile(filename);    //calls read file and puts returned struct in array
+                maze->numRooms++;    //updates room count
             }
         }
         closedir(d);    //close directory
     }
+
+    for (i = 0; i < maze->numRooms; i++) {    //swap the name-only connections for the real rooms
+        struct Room *room = maze->rooms[i];
+        int count = 0;
+
+        for (j = 0; j < room->currConnections; j++) {
+            struct Room *stub = room->connectingRooms[j];
+            struct Room *target = findRoom(maze, stub->name);    //look up the room the connection names
+
+            if (target)    //drop connections to rooms that aren't in the directory
+                room->connectingRooms[count++] = target;
+            free((char *) stub->name);
+            free(stub);
+        }
+        room->currConnections = count;
+        room->maxConnections = count;
+    }
+
+    __atomic_store_n(&currentMaze, maze, __ATOMIC_SEQ_CST);    //publish
 }
 
 
@@ -290,22 +453,22 @@ struct Room *readFile(const char *filename) {
 
     while (fgets(line, sizeof(line), file) != NULL) {    //while a line is still able to read in
         if (strncmp(line, "ROOM NAME", 9) == 0) {    //if first 9 characters of line match "ROOM NAME"
-            sscanf(line, "ROOM NAME: %s\n", input);    //scan in line taking room name as input
-            char *temp = malloc(strlen(input));    //dynamically allocate char array
+            sscanf(line, "ROOM NAME: %29s\n", input);    //scan in line taking room name as input
+            char *temp = malloc(strlen(input) + 1);    //dynamically allocate char array
             strcpy(temp, input);    //copy to char array
             gameRoom->name = temp;    //use to add room name to room struct
 
         } else if (strncmp(line, "CONNECTION", 10) == 0) {    //if first 10 characters of line match "CONNECTION"
             gameRoom->connectingRooms[count] = malloc(sizeof(struct Room));    //add more space to connection room array
-            sscanf(line, "CONNECTION %d: %s\n", &number, input);    //scan in line taking connecting room number and name as input
-            char *temp = malloc(strlen(input));    //dynamically allocate char array
+            sscanf(line, "CONNECTION %d: %29s\n", &number, input);    //scan in line taking connecting room number and name as input
+            char *temp = malloc(strlen(input) + 1);    //dynamically allocate char array
             strcpy(temp, input);    //copy to char array
             gameRoom->connectingRooms[count]->name = temp;    //use to add room name to connecting room array
             count++;    //increase connecting room count
 
         } else {    //otherwise
-            sscanf(line, "ROOM TYPE: %s\n", input);    //scan in line taking room type as input
-            char *temp = malloc(strlen(input));    //dynamicall allocate char array
+            sscanf(line, "ROOM TYPE: %29s\n", input);    //scan in line taking room type as input
+            char *temp = malloc(strlen(input) + 1);    //dynamicall allocate char array
             strcpy(temp, input);    //copy to char array
             gameRoom->roomType = temp;    //use to add room type
         }
@@ -319,108 +482,1427 @@ struct Room *readFile(const char *filename) {
 
 
 /***********************************************************
- * play: creates the interface for the game and lets the
- * user play.
+ * makeReaderKey: creates the thread key whose destructor
+ * gives a thread's reader slot back. run once.
  *
- * parameters: struct Room array.
+ * parameters: none.
  * returns: none.
  ***********************************************************/
 
-void play(struct Room **rooms) {
-    struct Room *currRoom;    //holds room information of room player is in
-    int path[50];    //holds numbers that corresponds to indices in rooms
-    int i, index, steps = 0;
-    const char *nextRoom;    //holds next room name
-    int resultCode;    //thread result code
-    pthread_t myThread;    //thread name
-    pthread_mutex_lock(&myMutex);    //try to lock the lock, will not continue if it's already locked
+void makeReaderKey() {
+    pthread_key_create(&readerKey, releaseReaderSlot);
+}
 
-    for (i = 0; i < ROOMS_IN_GAME; i++) {    //search through all rooms
-        if (strcmp(rooms[i]->roomType, "START_ROOM") == 0)    //find start room
-            currRoom = rooms[i];    //make start room the current room
-    }
 
-    do {
-        char input[30];
-        int i, valid = 0;
-        resultCode = pthread_create(&myThread, NULL, displayTime, NULL);    //create time thread
+/***********************************************************
+ * releaseReaderSlot: frees a reader slot for another thread.
+ * runs automatically when a thread that read the maze exits.
+ *
+ * parameters: struct ReaderSlot.
+ * returns: none.
+ ***********************************************************/
 
-        do {
-            valid = 0;    //check if input is valid
-            printf("CURRENT LOCATION: %s\n", currRoom->name);    //print current location
-            printf("POSSIBLE CONNECTIONS: ");    //print connections possible
+void releaseReaderSlot(void *slot) {
+    struct ReaderSlot *readerSlot = slot;
 
-            for (i = 0; i < currRoom->currConnections; i++) {    //for all current room's connections
-                if ((i + 1) < currRoom->currConnections)
-                    printf("%s, ", currRoom->connectingRooms[i]->name);    //print connecting room names with comma after
-                else
-                    printf("%s.\n", currRoom->connectingRooms[i]->name);    //print last connecting room name with period after
-            }
+    __atomic_store_n(&readerSlot->epoch, 0, __ATOMIC_SEQ_CST);    //not reading anymore
+    __atomic_store_n(&readerSlot->inUse, 0, __ATOMIC_SEQ_CST);    //let another thread claim it
+}
 
-            printf("WHERE TO? >");    //ask where to go
-            fgets(input, 30, stdin);    //get input from user
 
-            int last = strlen(input) - 1;    //check last char
-            if (input[last] == '\n')    //if it was a newline
-                input[last] = '\0';    //replace with null terminator
+/***********************************************************
+ * mazeEnter: marks the calling thread as reading the maze.
+ * any snapshot returned by mazeSnapshot stays valid until
+ * the matching mazeExit. calls can be nested, the thread
+ * stays reading until the outermost mazeExit. claims a
+ * reader slot the first time a thread calls it, waiting
+ * for one to free up if all MAX_READERS are taken.
+ *
+ * parameters: none.
+ * returns: none.
+ ***********************************************************/
 
-            for (i = 0; i < currRoom->currConnections; i++) {    //for all room connections
-                if (strcmp(input, currRoom->connectingRooms[i]->name) == 0) {    //if input matches connecting room name
-                    valid = 1;    //it's a valid choice
-                    nextRoom = currRoom->connectingRooms[i]->name;    //make this the next room
-                }
+void mazeEnter() {
+    int i;
+
+    if (readerDepth++ > 0)    //already reading, the epoch we announced still covers us
+        return;
+
+    if (readerSlot < 0) {    //first time this thread reads
+        pthread_once(&readerKeyOnce, makeReaderKey);
+
+        while (readerSlot < 0) {    //until we get a slot
+            for (i = 0; i < MAX_READERS && readerSlot < 0; i++) {    //find a free slot
+                int unused = 0;
+                if (__atomic_compare_exchange_n(&readerSlots[i].inUse, &unused, 1, 0,
+                                                __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+                    readerSlot = i;    //claimed it
             }
 
-            if (strcmp(input, "time") == 0) {    //if input was time
-                pthread_mutex_unlock(&myMutex);    //unlock the lock! this allows the second thread (time thread) to run
-                valid = 2;    //it's a valid choice
-                resultCode = pthread_join(myThread, NULL);    //don't continue until second thread has completed
-                pthread_mutex_lock(&myMutex);    //try to lock the lock, will not continue if it's already locked
+            if (readerSlot < 0)    //every slot is taken, let other threads finish
+                sched_yield();
+        }
+
+        pthread_setspecific(readerKey, &readerSlots[readerSlot]);    //release it when this thread exits
+    }
+
+    /*announce the epoch before loading the maze so writers can't free it under us*/
+    __atomic_store_n(&readerSlots[readerSlot].epoch,
+                     __atomic_load_n(&globalEpoch, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+}
+
+
+/***********************************************************
+ * mazeExit: marks the calling thread as done reading. after
+ * the outermost mazeExit the thread must not touch any
+ * snapshot it got.
+ *
+ * parameters: none.
+ * returns: none.
+ ***********************************************************/
+
+void mazeExit() {
+    if (--readerDepth == 0)    //leaving the outermost read
+        __atomic_store_n(&readerSlots[readerSlot].epoch, 0, __ATOMIC_SEQ_CST);    //no longer reading
+}
+
+
+/***********************************************************
+ * mazeSnapshot: gets the currently published maze. must be
+ * called between mazeEnter and mazeExit, and the snapshot
+ * must never be changed.
+ *
+ * parameters: none.
+ * returns: struct Maze.
+ ***********************************************************/
+
+struct Maze *mazeSnapshot() {
+    return __atomic_load_n(&currentMaze, __ATOMIC_SEQ_CST);
+}
+
+
+/***********************************************************
+ * findRoom: finds a room by name in a maze.
+ *
+ * parameters: struct Maze, c-string.
+ * returns: struct Room, or NULL if there's no such room.
+ ***********************************************************/
+
+struct Room *findRoom(struct Maze *maze, const char *name) {
+    int i;
+
+    for (i = 0; i < maze->numRooms; i++) {    //search through all rooms
+        if (strcmp(maze->rooms[i]->name, name) == 0)
+            return maze->rooms[i];
+    }
+    return NULL;
+}
+
+
+/***********************************************************
+ * copyString: dynamically allocates a copy of a c-string.
+ *
+ * parameters: c-string.
+ * returns: c-string.
+ ***********************************************************/
+
+char *copyString(const char *input) {
+    char *temp = malloc(strlen(input) + 1);    //dynamically allocate char array
+    strcpy(temp, input);    //copy to char array
+    return temp;
+}
+
+
+/***********************************************************
+ * cloneMaze: makes a deep copy of a maze that a writer can
+ * change without readers seeing it.
+ *
+ * parameters: struct Maze.
+ * returns: struct Maze.
+ ***********************************************************/
+
+struct Maze *cloneMaze(struct Maze *old) {
+    struct Maze *maze = malloc(sizeof(struct Maze));
+    int i, j, k;
+
+    maze->version = old->version + 1;
+    maze->numRooms = old->numRooms;
+
+    for (i = 0; i < old->numRooms; i++) {    //copy each room without its connections
+        struct Room *room = malloc(sizeof(struct Room));
+        room->name = copyString(old->rooms[i]->name);
+        room->roomType = copyString(old->rooms[i]->roomType);
+        room->maxConnections = old->rooms[i]->maxConnections;
+        room->currConnections = old->rooms[i]->currConnections;
+        maze->rooms[i] = room;
+    }
+
+    for (i = 0; i < old->numRooms; i++) {    //point connections at the copied rooms
+        for (j = 0; j < old->rooms[i]->currConnections; j++) {
+            for (k = 0; k < old->numRooms; k++) {
+                if (old->rooms[i]->connectingRooms[j] == old->rooms[k])
+                    maze->rooms[i]->connectingRooms[j] = maze->rooms[k];
             }
+        }
+    }
 
-            if (valid == 0)    //if choice isn't valid, print error message and reloop
-                printf("\nHUH? I DON'T UNDERSTAND THAT ROOM.  TRY AGAIN\n");
+    return maze;
+}
 
-            printf("\n");
-        } while (valid == 0);    //continue loop until choice is valid
 
-        if (valid == 1) {    //if choice was connecting room
-            steps++;    //increase step count
+/***********************************************************
+ * freeRoom: frees a room and its strings.
+ *
+ * parameters: struct Room.
+ * returns: none.
+ ***********************************************************/
+
+void freeRoom(struct Room *room) {
+    free((char *) room->name);
+    free((char *) room->roomType);
+    free(room);
+}
+
+
+/***********************************************************
+ * freeMaze: frees a maze and all of its rooms.
+ *
+ * parameters: struct Maze.
+ * returns: none.
+ ***********************************************************/
+
+void freeMaze(struct Maze *maze) {
+    int i;
+
+    for (i = 0; i < maze->numRooms; i++)
+        freeRoom(maze->rooms[i]);
+    free(maze);
+}
+
+
+/***********************************************************
+ * reclaimMazes: frees retired snapshots that no reader can
+ * still be holding, and puts the rest back on the list.
+ *
+ * parameters: none.
+ * returns: none.
+ ***********************************************************/
+
+void reclaimMazes() {
+    struct RetiredMaze *list = __atomic_exchange_n(&retiredMazes, NULL, __ATOMIC_SEQ_CST);    //take the whole list
+    unsigned long oldest = ULONG_MAX;    //oldest epoch any reader is in
+    int i;
+
+    for (i = 0; i < MAX_READERS; i++) {    //check all reader slots
+        unsigned long epoch = __atomic_load_n(&readerSlots[i].epoch, __ATOMIC_SEQ_CST);
+        if (epoch != 0 && epoch < oldest)
+            oldest = epoch;
+    }
+
+    while (list) {
+        struct RetiredMaze *next = list->next;
+
+        if (list->epoch < oldest) {    //every reader entered after it was replaced
+            freeMaze(list->maze);
+            free(list);
+            __atomic_fetch_add(&mazeReclaims, 1, __ATOMIC_RELAXED);
+        } else {    //somebody might still be reading it, put it back
+            list->next = __atomic_load_n(&retiredMazes, __ATOMIC_SEQ_CST);
+            while (!__atomic_compare_exchange_n(&retiredMazes, &list->next, list, 0,
+                                                __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+        }
+        list = next;
+    }
+}
+
+
+/***********************************************************
+ * retireMaze: queues a replaced snapshot to be freed once
+ * the readers that might hold it are done.
+ *
+ * parameters: struct Maze.
+ * returns: none.
+ ***********************************************************/
+
+void retireMaze(struct Maze *maze) {
+    struct RetiredMaze *retired = malloc(sizeof(struct RetiredMaze));
+
+    retired->maze = maze;
+    retired->epoch = __atomic_fetch_add(&globalEpoch, 1, __ATOMIC_SEQ_CST);    //readers entering from now on see the new maze
+    retired->next = __atomic_load_n(&retiredMazes, __ATOMIC_SEQ_CST);
+    while (!__atomic_compare_exchange_n(&retiredMazes, &retired->next, retired, 0,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+
+    reclaimMazes();    //free anything that's safe now
+}
+
+
+/***********************************************************
+ * goodRoomName: checks a name fits the game's MAX_NAME
+ * buffers and can be typed in as one word.
+ *
+ * parameters: c-string.
+ * returns: 1 if it's a usable name, 0 otherwise.
+ ***********************************************************/
+
+int goodRoomName(const char *name) {
+    size_t length = strlen(name);
+
+    return length > 0 && length < MAX_NAME && strpbrk(name, " \t\r\n") == NULL;
+}
+
+
+/***********************************************************
+ * mazePlayable: checks a maze can still be finished from
+ * anywhere a player could be: the end room can be reached
+ * from the start room, every room with exits is connected
+ * to the start room, and no room that had exits in the old
+ * maze has been left without any.
+ *
+ * parameters: old struct Maze or NULL, struct Maze.
+ * returns: 1 if it's playable, 0 otherwise.
+ ***********************************************************/
 
-            for (i = 0; i < ROOMS_IN_GAME; i++) {    //for all rooms
-                if (strcmp(rooms[i]->name, nextRoom) == 0) {    //when next room matches a name in room struct array
-                    currRoom = rooms[i];    //set current room
-                    path[steps - 1] = i;    //add room index to the path to print later
+int mazePlayable(struct Maze *old, struct Maze *maze) {
+    struct Room *queue[MAX_ROOMS];    //rooms found but not yet walked from
+    int reached[MAX_ROOMS];
+    int head = 0, tail = 0;
+    int i, j, k, start = -1, end = -1;
+
+    for (i = 0; i < maze->numRooms; i++) {    //find start and end rooms
+        if (strcmp(maze->rooms[i]->roomType, "START_ROOM") == 0)
+            start = i;
+        else if (strcmp(maze->rooms[i]->roomType, "END_ROOM") == 0)
+            end = i;
+        reached[i] = 0;
+    }
+    if (start < 0 || end < 0)
+        return 0;
+
+    /*walk the connections from the start room the way a player would*/
+    reached[start] = 1;
+    queue[tail++] = maze->rooms[start];
+    while (head < tail) {
+        struct Room *room = queue[head++];
+
+        for (j = 0; j < room->currConnections; j++) {
+            for (k = 0; k < maze->numRooms; k++) {    //find which room it is
+                if (maze->rooms[k] == room->connectingRooms[j] && !reached[k]) {
+                    reached[k] = 1;
+                    queue[tail++] = maze->rooms[k];
                 }
             }
         }
+    }
 
-        if (valid == 2) {    //if choice was time
-            int c;
-            FILE *file = fopen("currentTime.txt", "r");    //open currentTime file
-            if (file) {    //if it opens
-                while ((c = getc(file)) != EOF)    //while the end of file hasn't been reached
-                    putchar(c);    //print each char
-                fclose(file);    //close file
-            }
+    if (!reached[end])    //nobody could win
+        return 0;
+
+    for (i = 0; i < maze->numRooms; i++) {    //check rooms the walk didn't reach
+        struct Room *before;
+
+        if (reached[i])
+            continue;
+        if (maze->rooms[i]->currConnections > 0)    //a player in there couldn't get to the end
+            return 0;
+        before = old ? findRoom(old, maze->rooms[i]->name) : NULL;
+        if (before && before->currConnections > 0)    //a player in there would be stranded
+            return 0;
+    }
+
+    return 1;
+}
+
+
+/***********************************************************
+ * editMaze: copies the current maze, applies a change to the
+ * copy, and publishes it. if another writer published first
+ * the change is retried on the newer maze. changes that
+ * would leave the maze unplayable are rejected. safe to
+ * call while reading, snapshots the caller holds stay
+ * valid.
+ *
+ * parameters: edit function, 2 c-strings passed to it.
+ * returns: 1 if the change was published, 0 if the edit
+ * function rejected it or it would make the maze
+ * unplayable.
+ ***********************************************************/
+
+int editMaze(int (*edit)(struct Maze *, const char *, const char *), const char *a, const char *b) {
+    while (1) {
+        mazeEnter();    //keep the old maze alive while copying it
+        struct Maze *old = mazeSnapshot();
+        struct Maze *maze = cloneMaze(old);
+
+        if (!edit(maze, a, b) || !mazePlayable(old, maze)) {    //if the change isn't allowed
+            freeMaze(maze);
+            mazeExit();
+            return 0;
+        }
+
+        if (__atomic_compare_exchange_n(&currentMaze, &old, maze, 0,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {    //publish if nobody beat us to it
+            mazeExit();
+            retireMaze(old);
+            return 1;
         }
 
-    } while ((strcmp(currRoom->roomType, "END_ROOM") != 0) && (steps < 50));    //continue looping until end room is reached or path array is full (50 steps)
+        freeMaze(maze);    //lost the race, try again on the newer maze
+        mazeExit();
+        __atomic_fetch_add(&mazeRetries, 1, __ATOMIC_RELAXED);
+    }
+}
 
-    if (steps == 50) {    //if path array is full (50 steps)
-        printf("IT TOOK YOU 50 STEPS AND YOU STILL COULDN'T SOLVE IT... SAD!\n");    //print fail message and exit
-        return;
+
+/***********************************************************
+ * connectRooms: adds a two way connection to a maze copy.
+ *
+ * parameters: struct Maze, 2 c-strings.
+ * returns: 1 if connected, 0 otherwise.
+ ***********************************************************/
+
+int connectRooms(struct Maze *maze, const char *from, const char *to) {
+    struct Room *a = findRoom(maze, from);
+    struct Room *b = findRoom(maze, to);
+    int i;
+
+    if (!a || !b || a == b)    //both rooms have to exist and be different
+        return 0;
+    if (a->currConnections == MAX_CONNECTIONS || b->currConnections == MAX_CONNECTIONS)    //no room for more connections
+        return 0;
+
+    for (i = 0; i < a->currConnections; i++) {    //don't connect twice
+        if (a->connectingRooms[i] == b)
+            return 0;
     }
 
-    if (strcmp(currRoom->roomType, "END_ROOM") == 0) {    //if end room is reached
-        printf("YOU HAVE FOUND THE END ROOM. CONGRATULATIONS!\n");    //print congrats message
-        printf("YOU TOOK %d STEPS.  YOUR PATH TO VICTORY WAS:\n", steps);    //print amount of steps
+    a->connectingRooms[a->currConnections++] = b;    //add room b to room a connections
+    b->connectingRooms[b->currConnections++] = a;    //add room a to room b connections
+    a->maxConnections = a->currConnections;
+    b->maxConnections = b->currConnections;
+    return 1;
+}
+
+
+/***********************************************************
+ * unlinkRoom: removes one side of a connection.
+ *
+ * parameters: 2 struct Rooms.
+ * returns: 1 if room b was connected to room a, 0 otherwise.
+ ***********************************************************/
+
+int unlinkRoom(struct Room *a, struct Room *b) {
+    int i, j;
 
-        for (i = 0; i < steps; i++) {    //for each step
-            index = path[i];    //get index of room name from path
-            printf("%s\n", rooms[index]->name);    //print room name along path taken
+    for (i = 0; i < a->currConnections; i++) {
+        if (a->connectingRooms[i] == b) {
+            for (j = i + 1; j < a->currConnections; j++)    //shift the rest down to keep the order
+                a->connectingRooms[j - 1] = a->connectingRooms[j];
+            a->currConnections--;
+            a->maxConnections = a->currConnections;
+            return 1;
         }
     }
-    resultCode = pthread_cancel(myThread);    //cancel second thread
-    pthread_mutex_destroy(&myMutex);    //destroy lock
+    return 0;
+}
+
+
+/***********************************************************
+ * disconnectRooms: removes a two way connection from a maze
+ * copy.
+ *
+ * parameters: struct Maze, 2 c-strings.
+ * returns: 1 if disconnected, 0 otherwise.
+ ***********************************************************/
+
+int disconnectRooms(struct Maze *maze, const char *from, const char *to) {
+    struct Room *a = findRoom(maze, from);
+    struct Room *b = findRoom(maze, to);
+
+    if (!a || !b || !unlinkRoom(a, b))    //rooms have to exist and be connected
+        return 0;
+
+    unlinkRoom(b, a);
+    return 1;
+}
+
+
+/***********************************************************
+ * insertRoom: adds an unconnected mid room to a maze copy.
+ *
+ * parameters: struct Maze, c-string, unused c-string.
+ * returns: 1 if added, 0 otherwise.
+ ***********************************************************/
+
+int insertRoom(struct Maze *maze, const char *name, const char *unused) {
+    struct Room *room;
+
+    if (!goodRoomName(name))    //name has to fit the game's buffers and have no whitespace
+        return 0;
+    if (maze->numRooms == MAX_ROOMS || findRoom(maze, name))    //maze is full or room already exists
+        return 0;
+
+    room = malloc(sizeof(struct Room));
+    room->name = copyString(name);
+    room->roomType = copyString("MID_ROOM");    //start and end rooms are fixed
+    room->maxConnections = 0;
+    room->currConnections = 0;
+    maze->rooms[maze->numRooms++] = room;
+    return 1;
+}
+
+
+/***********************************************************
+ * deleteRoom: removes a mid room and every connection to it
+ * from a maze copy.
+ *
+ * parameters: struct Maze, c-string, unused c-string.
+ * returns: 1 if removed, 0 otherwise.
+ ***********************************************************/
+
+int deleteRoom(struct Maze *maze, const char *name, const char *unused) {
+    struct Room *room = findRoom(maze, name);
+    int i, index = 0;
+
+    if (!room || strcmp(room->roomType, "MID_ROOM") != 0)    //start and end rooms can't be removed
+        return 0;
+
+    for (i = 0; i < room->currConnections; i++)    //remove the room from its neighbors
+        unlinkRoom(room->connectingRooms[i], room);
+
+    for (i = 0; i < maze->numRooms; i++) {    //close the gap in the room array
+        if (maze->rooms[i] != room)
+            maze->rooms[index++] = maze->rooms[i];
+    }
+    maze->numRooms = index;
+
+    freeRoom(room);
+    return 1;
+}
+
+
+/***********************************************************
+ * mazeAddConnection: connects two rooms in the live maze.
+ *
+ * parameters: 2 c-strings.
+ * returns: 1 if connected, 0 if a room is missing, full,
+ * or they're already connected.
+ ***********************************************************/
+
+int mazeAddConnection(const char *from, const char *to) {
+    return editMaze(connectRooms, from, to);
+}
+
+
+/***********************************************************
+ * mazeRemoveConnection: disconnects two rooms in the live
+ * maze.
+ *
+ * parameters: 2 c-strings.
+ * returns: 1 if disconnected, 0 if they weren't connected.
+ ***********************************************************/
+
+int mazeRemoveConnection(const char *from, const char *to) {
+    return editMaze(disconnectRooms, from, to);
+}
+
+
+/***********************************************************
+ * mazeAddRoom: adds an unconnected mid room to the live
+ * maze. connect it with mazeAddConnection.
+ *
+ * parameters: c-string.
+ * returns: 1 if added, 0 if the maze is full or the name
+ * is taken, too long, or has whitespace.
+ ***********************************************************/
+
+int mazeAddRoom(const char *name) {
+    return editMaze(insertRoom, name, NULL);
+}
+
+
+/***********************************************************
+ * mazeRemoveRoom: removes a mid room from the live maze.
+ * players standing in it are sent back to the start room.
+ *
+ * parameters: c-string.
+ * returns: 1 if removed, 0 if it's missing or isn't a mid
+ * room.
+ ***********************************************************/
+
+int mazeRemoveRoom(const char *name) {
+    return editMaze(deleteRoom, name, NULL);
+}
+
+
+/***********************************************************
+ * isEndRoom: checks if a room in the live maze is the end
+ * room.
+ *
+ * parameters: c-string.
+ * returns: 1 if it's the end room, 0 otherwise.
+ ***********************************************************/
+
+int isEndRoom(const char *name) {
+    int end = 0;
+
+    mazeEnter();
+    struct Room *room = findRoom(mazeSnapshot(), name);
+    if (room && strcmp(room->roomType, "END_ROOM") == 0)
+        end = 1;
+    mazeExit();
+
+    return end;
+}
+
+
+/***********************************************************
+ * play: creates the interface for the game and lets the
+ * user play. every look at the maze reads the published
+ * snapshot, so the maze can change between moves.
+ *
+ * parameters: none.
+ * returns: none.
+ ***********************************************************/
+
+void play() {
+    struct Maze *maze;    //snapshot being read
+    struct Room *currRoom;    //holds room information of room player is in
+    char currName[MAX_NAME];    //name of room player is in
+    char path[MAX_STEPS][MAX_NAME];    //holds names of rooms visited, rooms might not exist later
+    int i, steps = 0;
+    char nextRoom[MAX_NAME];    //holds next room name
+    int resultCode;    //thread result code
+    pthread_t myThread;    //thread name
+    pthread_mutex_lock(&myMutex);    //try to lock the lock, will not continue if it's already locked
+
+    currName[0] = '\0';
+    mazeEnter();
+    maze = mazeSnapshot();
+    for (i = 0; i < maze->numRooms; i++) {    //search through all rooms
+        if (strcmp(maze->rooms[i]->roomType, "START_ROOM") == 0)    //find start room
+            strcpy(currName, maze->rooms[i]->name);    //make start room the current room
+    }
+    mazeExit();
+
+    do {
+        char input[30];
+        int i, valid = 0;
+        resultCode = pthread_create(&myThread, NULL, displayTime, NULL);    //create time thread
+
+        do {
+            valid = 0;    //check if input is valid
+
+            mazeEnter();
+            maze = mazeSnapshot();
+            currRoom = findRoom(maze, currName);
+            if (!currRoom) {    //if the room was removed while the player was in it
+                for (i = 0; i < maze->numRooms; i++) {    //go back to the start room
+                    if (strcmp(maze->rooms[i]->roomType, "START_ROOM") == 0)
+                        currRoom = maze->rooms[i];
+                }
+                strcpy(currName, currRoom->name);
+            }
+
+            printf("CURRENT LOCATION: %s\n", currRoom->name);    //print current location
+            printf("POSSIBLE CONNECTIONS: ");    //print connections possible
+
+            if (currRoom->currConnections == 0)    //room has no way out
+                printf("NONE.\n");
+
+            for (i = 0; i < currRoom->currConnections; i++) {    //for all current room's connections
+                if ((i + 1) < currRoom->currConnections)
+                    printf("%s, ", currRoom->connectingRooms[i]->name);    //print connecting room names with comma after
+                else
+                    printf("%s.\n", currRoom->connectingRooms[i]->name);    //print last connecting room name with period after
+            }
+            mazeExit();    //don't hold the snapshot while waiting on the player
+
+            printf("WHERE TO? >");    //ask where to go
+            fgets(input, 30, stdin);    //get input from user
+
+            int last = strlen(input) - 1;    //check last char
+            if (input[last] == '\n')    //if it was a newline
+                input[last] = '\0';    //replace with null terminator
+
+            mazeEnter();    //check against the newest maze
+            currRoom = findRoom(mazeSnapshot(), currName);
+            for (i = 0; currRoom && i < currRoom->currConnections; i++) {    //for all room connections
+                if (strcmp(input, currRoom->connectingRooms[i]->name) == 0) {    //if input matches connecting room name
+                    valid = 1;    //it's a valid choice
+                    strcpy(nextRoom, currRoom->connectingRooms[i]->name);    //make this the next room
+                }
+            }
+            mazeExit();
+
+            if (strcmp(input, "time") == 0) {    //if input was time
+                pthread_mutex_unlock(&myMutex);    //unlock the lock! this allows the second thread (time thread) to run
+                valid = 2;    //it's a valid choice
+                resultCode = pthread_join(myThread, NULL);    //don't continue until second thread has completed
+                pthread_mutex_lock(&myMutex);    //try to lock the lock, will not continue if it's already locked
+            }
+
+            if (valid == 0)    //if choice isn't valid, print error message and reloop
+                printf("\nHUH? I DON'T UNDERSTAND THAT ROOM.  TRY AGAIN\n");
+
+            printf("\n");
+        } while (valid == 0);    //continue loop until choice is valid
+
+        if (valid == 1) {    //if choice was connecting room
+            steps++;    //increase step count
+            strcpy(currName, nextRoom);    //set current room
+            strcpy(path[steps - 1], nextRoom);    //add room name to the path to print later
+        }
+
+        if (valid == 2) {    //if choice was time
+            int c;
+            FILE *file = fopen("currentTime.txt", "r");    //open currentTime file
+            if (file) {    //if it opens
+                while ((c = getc(file)) != EOF)    //while the end of file hasn't been reached
+                    putchar(c);    //print each char
+                fclose(file);    //close file
+            }
+        }
+
+    } while (!isEndRoom(currName) && (steps < MAX_STEPS));    //continue looping until end room is reached or path array is full (50 steps)
+
+    if (!isEndRoom(currName)) {    //if path array is full (50 steps)
+        printf("IT TOOK YOU 50 STEPS AND YOU STILL COULDN'T SOLVE IT... SAD!\n");    //print fail message and exit
+        return;
+    }
+
+    printf("YOU HAVE FOUND THE END ROOM. CONGRATULATIONS!\n");    //print congrats message
+    printf("YOU TOOK %d STEPS.  YOUR PATH TO VICTORY WAS:\n", steps);    //print amount of steps
+
+    for (i = 0; i < steps; i++)    //for each step
+        printf("%s\n", path[i]);    //print room name along path taken
+
+    resultCode = pthread_cancel(myThread);    //cancel second thread
+    pthread_mutex_destroy(&myMutex);    //destroy lock
+}
+
+
+/***********************************************************
+ * createControl: makes the helmsk.control.<pid> fifo next
+ * to the room directories, not inside one, so it doesn't
+ * change which maze selectDirectory picks. tells the
+ * operator where it is on stderr.
+ *
+ * parameters: none.
+ * returns: 1 if the fifo was made, 0 otherwise.
+ ***********************************************************/
+
+int createControl() {
+    char directory[PATH_MAX - 32];    //leave space for the fifo name
+
+    if (!getcwd(directory, sizeof(directory)))
+        return 0;
+
+    sprintf(controlPath, "%s/helmsk.control.%d", directory, getpid());    //process id keeps it unique
+    if (mkfifo(controlPath, 0600) != 0)
+        return 0;
+
+    fprintf(stderr, "MAZE CONTROL: %s\n", controlPath);
+    return 1;
+}
+
+
+/***********************************************************
+ * mazeControl: reshapes the live maze while the game runs.
+ * reads commands from the control fifo, one per line:
+ *   connect <room> <room>
+ *   disconnect <room> <room>
+ *   add <room>
+ *   remove <room>
+ * results go to stderr. e.g. from another terminal:
+ *   echo "connect DennyDen LeschiLake" > helmsk.control.<pid>
+ *
+ * parameters: null pointer.
+ * returns: NULL.
+ ***********************************************************/
+
+void *mazeControl(void *arg) {
+    char line[100];
+    char command[100], first[100], second[100];    //as big as the line, the edits check name length
+
+    while (1) {
+        FILE *file = fopen(controlPath, "r");    //waits until someone opens it for writing
+        if (!file)
+            return NULL;
+
+        while (fgets(line, sizeof(line), file) != NULL) {    //for each command sent
+            int count = sscanf(line, "%99s %99s %99s", command, first, second);
+            int done;
+
+            if (count == 3 && strcmp(command, "connect") == 0)
+                done = mazeAddConnection(first, second);
+            else if (count == 3 && strcmp(command, "disconnect") == 0)
+                done = mazeRemoveConnection(first, second);
+            else if (count == 2 && strcmp(command, "add") == 0)
+                done = mazeAddRoom(first);
+            else if (count == 2 && strcmp(command, "remove") == 0)
+                done = mazeRemoveRoom(first);
+            else if (count < 1)    //skip blank lines
+                continue;
+            else {
+                fprintf(stderr, "control: unknown command %s", line);
+                continue;
+            }
+
+            fprintf(stderr, "control: %s %s\n", command, done ? "done" : "refused");
+        }
+        fclose(file);    //writer closed its end, wait for the next one
+    }
+}
+
+
+/***********************************************************
+ * checkSnapshot: checks a snapshot is a whole maze: every
+ * connection points at a room in the same snapshot and
+ * goes both ways, there's one start and one end room, and
+ * it's playable.
+ *
+ * parameters: struct Maze.
+ * returns: 1 if it's whole, 0 otherwise.
+ ***********************************************************/
+
+int checkSnapshot(struct Maze *maze) {
+    int i, j, k, starts = 0, ends = 0;
+
+    if (maze->numRooms > MAX_ROOMS)
+        return 0;
+
+    for (i = 0; i < maze->numRooms; i++) {    //for all rooms
+        struct Room *room = maze->rooms[i];
+
+        if (strcmp(room->roomType, "START_ROOM") == 0)
+            starts++;
+        else if (strcmp(room->roomType, "END_ROOM") == 0)
+            ends++;
+
+        for (j = 0; j < room->currConnections; j++) {    //for all connections
+            struct Room *other = room->connectingRooms[j];
+            int back = 0;
+
+            if (findRoom(maze, other->name) != other)    //connection left over from another snapshot
+                return 0;
+            for (k = 0; k < other->currConnections; k++) {    //look for the way back
+                if (other->connectingRooms[k] == room)
+                    back = 1;
+            }
+            if (!back)
+                return 0;
+        }
+    }
+
+    return starts == 1 && ends == 1 && mazePlayable(NULL, maze);
+}
+
+
+/***********************************************************
+ * stressWriter: makes random edits to the live maze.
+ *
+ * parameters: seed for rand_r.
+ * returns: NULL.
+ ***********************************************************/
+
+void *stressWriter(void *arg) {
+    unsigned int seed = (unsigned int) (long) arg;
+    int i;
+
+    for (i = 0; i < STRESS_EDITS; i++) {    //make edits
+        const char *a = roomNames[rand_r(&seed) % MAX_ROOMS];
+        const char *b = roomNames[rand_r(&seed) % MAX_ROOMS];
+
+        switch (rand_r(&seed) % 4) {
+            case 0:
+                mazeAddConnection(a, b);
+                break;
+            case 1:
+                mazeRemoveConnection(a, b);
+                break;
+            case 2:
+                mazeAddRoom(a);
+                break;
+            default:
+                mazeRemoveRoom(a);
+        }
+    }
+    return NULL;
+}
+
+
+/***********************************************************
+ * stressReader: reads snapshots while writers change the
+ * maze, sometimes editing from inside its own read, and
+ * checks every snapshot it sees stays whole.
+ *
+ * parameters: seed for rand_r.
+ * returns: NULL.
+ ***********************************************************/
+
+void *stressReader(void *arg) {
+    unsigned int seed = (unsigned int) (long) arg;
+    int i;
+
+    for (i = 0; i < STRESS_READS; i++) {    //take snapshots
+        mazeEnter();
+        struct Maze *maze = mazeSnapshot();
+
+        if (!checkSnapshot(maze))
+            __atomic_fetch_add(&stressErrors, 1, __ATOMIC_RELAXED);
+
+        if (rand_r(&seed) % 16 == 0) {    //edit while still holding the snapshot
+            mazeAddConnection(roomNames[rand_r(&seed) % MAX_ROOMS], roomNames[rand_r(&seed) % MAX_ROOMS]);
+            if (!checkSnapshot(maze))    //ours must not have been freed or changed
+                __atomic_fetch_add(&stressErrors, 1, __ATOMIC_RELAXED);
+        }
+        mazeExit();
+    }
+    return NULL;
+}
+
+
+/***********************************************************
+ * stressMaze: checks an edit that would strand the start
+ * room is refused, then runs writers against waves of
+ * short lived readers on an in memory maze, more readers in
+ * total than there are reader slots, then checks every
+ * replaced snapshot was reclaimed.
+ *
+ * parameters: none.
+ * returns: exit int, 1 if anything went wrong.
+ ***********************************************************/
+
+int stressMaze() {
+    struct Maze *maze = malloc(sizeof(struct Maze));
+    pthread_t writers[STRESS_WRITERS], readers[MAX_READERS];
+    unsigned long published;
+    int i, wave;
+
+    maze->version = 1;
+    maze->numRooms = 7;
+    for (i = 0; i < maze->numRooms; i++) {    //rooms in a ring
+        maze->rooms[i] = malloc(sizeof(struct Room));
+        maze->rooms[i]->name = copyString(roomNames[i]);
+        maze->rooms[i]->roomType = copyString(i == 0 ? "START_ROOM" : (i == 6 ? "END_ROOM" : "MID_ROOM"));
+        maze->rooms[i]->currConnections = 0;
+    }
+    for (i = 0; i < maze->numRooms; i++) {    //each room connects to the rooms one and two away
+        struct Room *room = maze->rooms[i];
+        room->connectingRooms[room->currConnections++] = maze->rooms[(i + 1) % 7];
+        room->connectingRooms[room->currConnections++] = maze->rooms[(i + 6) % 7];
+        room->connectingRooms[room->currConnections++] = maze->rooms[(i + 2) % 7];
+        room->connectingRooms[room->currConnections++] = maze->rooms[(i + 5) % 7];
+        room->maxConnections = room->currConnections;
+    }
+    __atomic_store_n(&currentMaze, maze, __ATOMIC_SEQ_CST);    //publish
+
+    /*cutting the start room off completely has to be refused, the cuts before it are fine*/
+    if (!mazeRemoveConnection(roomNames[0], roomNames[1]) || !mazeRemoveConnection(roomNames[0], roomNames[6]) ||
+        !mazeRemoveConnection(roomNames[0], roomNames[2]) || mazeRemoveConnection(roomNames[0], roomNames[5])) {
+        printf("STRESS CHECK FAILED: start room could be cut off\n");
+        return 1;
+    }
+    mazeAddConnection(roomNames[0], roomNames[1]);    //put the ring back
+    mazeAddConnection(roomNames[0], roomNames[6]);
+    mazeAddConnection(roomNames[0], roomNames[2]);
+
+    for (i = 0; i < STRESS_WRITERS; i++)    //start writers
+        pthread_create(&writers[i], NULL, stressWriter, (void *) (long) (i + 1));
+
+    for (wave = 0; wave < STRESS_WAVES; wave++) {    //each wave fills every reader slot
+        for (i = 0; i < MAX_READERS - STRESS_WRITERS; i++)
+            pthread_create(&readers[i], NULL, stressReader, (void *) (long) (wave * MAX_READERS + i + 100));
+        for (i = 0; i < MAX_READERS - STRESS_WRITERS; i++)
+            pthread_join(readers[i], NULL);
+    }
+
+    for (i = 0; i < STRESS_WRITERS; i++)    //wait for writers
+        pthread_join(writers[i], NULL);
+
+    reclaimMazes();    //nobody is reading now, everything retired can go
+    published = currentMaze->version - 1;
+
+    printf("%lu edits published, %lu retried, %lu snapshots reclaimed, %d bad snapshots\n",
+           published, mazeRetries, mazeReclaims, stressErrors);
+
+    if (stressErrors > 0 || retiredMazes != NULL || mazeReclaims != published || !checkSnapshot(currentMaze)) {
+        printf("STRESS CHECK FAILED\n");
+        return 1;
+    }
+    return 0;
+}
+
+
+/***********************************************************
+ * report: adds a violation message to a maze's report.
+ *
+ * parameters: struct Report, printf style format and
+ * arguments.
+ * returns: none.
+ ***********************************************************/
+
+void report(struct Report *result, const char *format, ...) {
+    va_list args;
+    int length;
+
+    va_start(args, format);
+    length = vsnprintf(NULL, 0, format, args);    //find out how much space the message needs
+    va_end(args);
+
+    if (result->length + length + 2 > result->size) {    //grow the buffer if it won't fit
+        result->size = (result->length + length + 2) * 2;
+        result->text = realloc(result->text, result->size);
+    }
+
+    va_start(args, format);
+    vsnprintf(result->text + result->length, length + 1, format, args);    //add the message
+    va_end(args);
+
+    result->length += length;
+    result->text[result->length++] = '\n';
+    result->text[result->length] = '\0';
+    result->violations++;
+}
+
+
+/***********************************************************
+ * readName: copies a room name or type from the end of a
+ * room file line.
+ *
+ * parameters: c-string to read from, c-string to copy into.
+ * returns: NULL if it's a good name, otherwise what's
+ * wrong with it.
+ ***********************************************************/
+
+const char *readName(const char *text, char *name) {
+    int i;
+
+    name[0] = '\0';    //stays empty if the name is bad
+
+    for (i = 0; text[i] != '\0'; i++) {    //check every character
+        if (text[i] == ' ' || text[i] == '\t' || text[i] == '\r')
+            return "has whitespace in the name";
+        if (i == MAX_NAME - 1)    //no room for the null terminator
+            return "name is too long";
+    }
+
+    if (i == 0)
+        return "name is empty";
+
+    memcpy(name, text, i);
+
+    name[i] = '\0';
+    return NULL;
+}
+
+
+/***********************************************************
+ * checkRoomFile: reads one room file, checking the format
+ * line by line, and stores what it found.
+ *
+ * parameters: directory name, open directory descriptor,
+ * file name, struct RoomCheck to fill, struct Report.
+ * returns: none.
+ ***********************************************************/
+
+void checkRoomFile(const char *dir, int dirFd, const char *filename, struct RoomCheck *room, struct Report *result) {
+    char buffer[MAX_FILE_SIZE + 1];    //whole file plus a null terminator
+    const char *problem;
+    ssize_t amount;
+    size_t total = 0;
+    int state = 0;    //0 expects the name, 1 connections or the type, 2 nothing
+    int lineNumber = 0;
+    char *line, *end;
+
+    memset(room, 0, sizeof(struct RoomCheck));
+    snprintf(room->file, sizeof(room->file), "%s", filename);
+
+    struct stat attr;
+    int fd = openat(dirFd, filename, O_RDONLY | O_NONBLOCK);    //open file for reading, without waiting on fifos
+    if (fd < 0) {    //if it doesn't open
+        report(result, "%s/%s: could not open file: %s", dir, filename, strerror(errno));
+        return;
+    }
+
+    if (fstat(fd, &attr) != 0 || !S_ISREG(attr.st_mode)) {    //directories, fifos and so on
+        report(result, "%s/%s: not a regular file, but the game would load it as a room", dir, filename);
+        close(fd);
+        return;
+    }
+
+    /*read the whole file in one go, room files are tiny*/
+    while (total <= MAX_FILE_SIZE) {
+        amount = read(fd, buffer + total, MAX_FILE_SIZE + 1 - total);
+        if (amount < 0 && errno == EINTR)    //interrupted, try again
+            continue;
+        if (amount < 0) {    //if it can't be read
+            report(result, "%s/%s: could not read file: %s", dir, filename, strerror(errno));
+            close(fd);
+            return;
+        }
+        if (amount == 0)    //end of file
+            break;
+        total += amount;
+    }
+    close(fd);    //close file
+
+    if (total > MAX_FILE_SIZE) {    //if it can't be a room file
+        report(result, "%s/%s: file is bigger than %d bytes", dir, filename, MAX_FILE_SIZE);
+        return;
+    }
+    buffer[total] = '\0';
+
+    for (line = buffer; line < buffer + total; line = end + 1) {    //for every line
+        lineNumber++;
+        end = memchr(line, '\n', buffer + total - line);    //find end of line
+        if (!end)    //last line has no newline
+            end = buffer + total;
+        *end = '\0';
+
+        if (strncmp(line, "ROOM NAME: ", 11) == 0) {    //if it's the room name
+            if (state != 0) {
+                report(result, "%s/%s:%d: ROOM NAME has to be the first line", dir, filename, lineNumber);
+                continue;
+            }
+            if ((problem = readName(line + 11, room->name)) != NULL)
+                report(result, "%s/%s:%d: %s", dir, filename, lineNumber, problem);
+            room->nameLine = lineNumber;
+            state = 1;
+
+        } else if (strncmp(line, "CONNECTION ", 11) == 0) {    //if it's a connection
+            char *rest;
+            long number = strtol(line + 11, &rest, 10);    //connection number
+            char name[MAX_NAME];
+
+            if (state != 1) {
+                report(result, "%s/%s:%d: CONNECTION has to be between ROOM NAME and ROOM TYPE", dir, filename, lineNumber);
+                continue;
+            }
+            if (rest == line + 11 || strncmp(rest, ": ", 2) != 0) {
+                report(result, "%s/%s:%d: malformed CONNECTION line", dir, filename, lineNumber);
+                continue;
+            }
+            if (number != room->numConnections + 1)    //connections are numbered from 1 in order
+                report(result, "%s/%s:%d: CONNECTION %ld should be CONNECTION %d", dir, filename, lineNumber,
+                       number, room->numConnections + 1);
+            if ((problem = readName(rest + 2, name)) != NULL) {
+                report(result, "%s/%s:%d: %s", dir, filename, lineNumber, problem);
+                continue;
+            }
+
+            if (room->numConnections < MAX_CONNECTIONS) {    //only keep what the game could hold
+                strcpy(room->connections[room->numConnections], name);
+                room->connectionLines[room->numConnections] = lineNumber;
+            }
+            room->numConnections++;
+
+        } else if (strncmp(line, "ROOM TYPE: ", 11) == 0) {    //if it's the room type
+            if (state != 1) {
+                report(result, "%s/%s:%d: ROOM TYPE has to come after ROOM NAME, and only once", dir, filename, lineNumber);
+                continue;
+            }
+            if ((problem = readName(line + 11, room->type)) != NULL)
+                report(result, "%s/%s:%d: %s", dir, filename, lineNumber, problem);
+            else if (strcmp(room->type, "START_ROOM") != 0 && strcmp(room->type, "MID_ROOM") != 0 &&
+                     strcmp(room->type, "END_ROOM") != 0)
+                report(result, "%s/%s:%d: unknown room type %s", dir, filename, lineNumber, room->type);
+            room->typeLine = lineNumber;
+            state = 2;
+
+        } else {    //otherwise
+            report(result, "%s/%s:%d: unrecognized line", dir, filename, lineNumber);
+        }
+    }
+
+    if (state == 0)
+        report(result, "%s/%s: missing ROOM NAME line", dir, filename);
+    else if (state == 1)
+        report(result, "%s/%s: missing ROOM TYPE line", dir, filename);
+
+    if (room->name[0] != '\0' && strcmp(room->name, filename) != 0)    //buildrooms names each file after its room
+        report(result, "%s/%s:%d: room %s is not in a file named after it, buildrooms always names them that way", dir,
+               filename, room->nameLine, room->name);
+}
+
+
+/***********************************************************
+ * findCheckedRoom: finds a room by name in the rooms read
+ * by the validator.
+ *
+ * parameters: struct RoomCheck array, room count, c-string.
+ * returns: index of the room, or -1 if there's no such room.
+ ***********************************************************/
+
+int findCheckedRoom(struct RoomCheck *rooms, int numRooms, const char *name) {
+    int i;
+
+    for (i = 0; i < numRooms; i++) {    //search through all rooms
+        if (strcmp(rooms[i].name, name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+
+/***********************************************************
+ * validateMaze: checks every room file in a maze directory
+ * and the maze as a whole: connections go both ways, each
+ * room has MIN_CONNECTIONS to MAX_CONNECTIONS connections,
+ * there's one start room and one end room, and the end room
+ * can be reached from the start room.
+ *
+ * parameters: directory name, struct Report.
+ * returns: none.
+ ***********************************************************/
+
+void validateMaze(const char *dir, struct Report *result) {
+    struct RoomCheck rooms[MAX_ROOMS];    //rooms that were read
+    struct RoomCheck extra;    //rooms past MAX_ROOMS, still checked for format
+    char **files = NULL;    //room file names, sorted before checking
+    int numRooms = 0, numFiles = 0;
+    int start = -1, end = -1;
+    int reached[MAX_ROOMS], queue[MAX_ROOMS];
+    int head = 0, tail = 0;
+    int i, j, k;
+    struct dirent *entry;
+    DIR *d = opendir(dir);    //open maze directory
+
+    if (!d) {    //if it doesn't open
+        report(result, "%s: could not open directory", dir);
+        return;
+    }
+
+    while ((entry = readdir(d)) != NULL) {    //collect everything the game would load
+        if (!isRoomFile(entry->d_name))    //the game won't load it either
+            continue;
+
+        files = realloc(files, (numFiles + 1) * sizeof(char *));
+        files[numFiles++] = copyString(entry->d_name);
+    }
+
+    /*check files in name order so reports and the rooms kept don't depend on directory order*/
+    qsort(files, numFiles, sizeof(char *), compareNames);
+    for (i = 0; i < numFiles; i++) {
+        if (numRooms < MAX_ROOMS)
+            checkRoomFile(dir, dirfd(d), files[i], &rooms[numRooms++], result);
+        else
+            checkRoomFile(dir, dirfd(d), files[i], &extra, result);
+        free(files[i]);
+    }
+    free(files);
+    closedir(d);    //close directory
+
+    if (numFiles > MAX_ROOMS)
+        report(result, "%s: %d rooms, the game can hold %d", dir, numFiles, MAX_ROOMS);
+
+    for (i = 0; i < numRooms; i++) {    //check each room against the rest of the maze
+        struct RoomCheck *room = &rooms[i];
+
+        if (room->name[0] == '\0')    //already reported as unreadable
+            continue;
+
+        j = findCheckedRoom(rooms, i, room->name);
+        if (j >= 0)
+            report(result, "%s/%s:%d: room %s is also in %s", dir, room->file, room->nameLine, room->name, rooms[j].file);
+
+        if (room->numConnections < MIN_CONNECTIONS || room->numConnections > MAX_CONNECTIONS)
+            report(result, "%s/%s:%d: room has %d connections, needs %d to %d", dir, room->file, room->nameLine,
+                   room->numConnections, MIN_CONNECTIONS, MAX_CONNECTIONS);
+
+        for (j = 0; j < room->numConnections && j < MAX_CONNECTIONS; j++) {    //for all connections
+            const char *name = room->connections[j];
+            int line = room->connectionLines[j];
+            int target, back = 0;
+
+            if (strcmp(name, room->name) == 0) {
+                report(result, "%s/%s:%d: room connects to itself", dir, room->file, line);
+                continue;
+            }
+
+            for (k = 0; k < j; k++) {    //check earlier connections
+                if (strcmp(room->connections[k], name) == 0)
+                    break;
+            }
+            if (k < j) {
+                report(result, "%s/%s:%d: room connects to %s twice", dir, room->file, line, name);
+                continue;
+            }
+
+            target = findCheckedRoom(rooms, numRooms, name);
+            if (target < 0) {
+                report(result, "%s/%s:%d: connection to missing room %s", dir, room->file, line, name);
+                continue;
+            }
+
+            for (k = 0; k < rooms[target].numConnections && k < MAX_CONNECTIONS; k++) {    //look for the way back
+                if (strcmp(rooms[target].connections[k], room->name) == 0)
+                    back = 1;
+            }
+            if (!back)
+                report(result, "%s/%s:%d: %s doesn't connect back", dir, room->file, line, name);
+        }
+
+        if (strcmp(room->type, "START_ROOM") == 0) {    //count start rooms
+            if (start >= 0)
+                report(result, "%s/%s:%d: another START_ROOM, first is %s", dir, room->file, room->typeLine, rooms[start].name);
+            else
+                start = i;
+        } else if (strcmp(room->type, "END_ROOM") == 0) {    //count end rooms
+            if (end >= 0)
+                report(result, "%s/%s:%d: another END_ROOM, first is %s", dir, room->file, room->typeLine, rooms[end].name);
+            else
+                end = i;
+        }
+    }
+
+    if (start < 0)
+        report(result, "%s: no START_ROOM", dir);
+    if (end < 0)
+        report(result, "%s: no END_ROOM", dir);
+    if (start < 0 || end < 0)
+        return;
+
+    /*walk the connections from the start room the way a player would*/
+    memset(reached, 0, sizeof(reached));
+    reached[start] = 1;
+    queue[tail++] = start;
+    while (head < tail) {
+        struct RoomCheck *room = &rooms[queue[head++]];
+
+        for (j = 0; j < room->numConnections && j < MAX_CONNECTIONS; j++) {
+            k = findCheckedRoom(rooms, numRooms, room->connections[j]);
+            if (k >= 0 && !reached[k]) {
+                reached[k] = 1;
+                queue[tail++] = k;
+            }
+        }
+    }
+
+    if (!reached[end])
+        report(result, "%s: END_ROOM %s can't be reached from START_ROOM %s", dir, rooms[end].name, rooms[start].name);
+}
+
+
+/***********************************************************
+ * validateWorker: validates maze directories until there
+ * are none left to take.
+ *
+ * parameters: struct ValidateJob.
+ * returns: NULL.
+ ***********************************************************/
+
+void *validateWorker(void *arg) {
+    struct ValidateJob *job = arg;
+    int i;
+
+    while ((i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->numDirs) {    //take the next directory
+        validateMaze(job->dirs[i], &job->reports[i]);
+        job->reports[i].checked = 1;
+    }
+
+    return NULL;
+}
+
+
+/***********************************************************
+ * compareNames: orders c-strings for qsort.
+ *
+ * parameters: 2 c-string pointers.
+ * returns: qsort comparison int.
+ ***********************************************************/
+
+int compareNames(const void *a, const void *b) {
+    return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+
+/***********************************************************
+ * validate: checks maze directories in parallel and prints
+ * every violation with its file and line. with no
+ * directories given it checks every helmsk.rooms. directory
+ * in the current directory.
+ *
+ * parameters: directory count, directory names.
+ * returns: exit int, 1 if any maze is invalid.
+ ***********************************************************/
+
+int validate(int numDirs, char **dirs) {
+    struct ValidateJob job;
+    pthread_t workers[MAX_WORKERS];
+    int numWorkers, started = 0, invalid = 0, found = 0;
+    int i;
+
+    if (numDirs == 0) {    //find all room directories
+        DIR *d = opendir(".");
+        struct dirent *dir;
+
+        if (d) {    //if it opens
+            while ((dir = readdir(d)) != NULL) {    //check all directories
+                if (strncmp(dir->d_name, "helmsk.rooms.", 13) == 0) {    //only look at directories with correct prefix
+                    dirs = realloc(found ? dirs : NULL, (numDirs + 1) * sizeof(char *));
+                    dirs[numDirs++] = copyString(dir->d_name);
+                    found = 1;
+                }
+            }
+            closedir(d);    //close directory
+        }
+        qsort(dirs, numDirs, sizeof(char *), compareNames);
+    }
+
+    if (numDirs == 0) {
+        printf("No maze directories to validate\n");
+        return 1;
+    }
+
+    for (i = 0; i < numDirs; i++) {    //drop trailing slashes so paths print cleanly
+        size_t length = strlen(dirs[i]);
+        while (length > 1 && dirs[i][length - 1] == '/')
+            dirs[i][--length] = '\0';
+    }
+
+    job.dirs = dirs;
+    job.numDirs = numDirs;
+    job.next = 0;
+    job.reports = calloc(numDirs, sizeof(struct Report));
+
+    numWorkers = sysconf(_SC_NPROCESSORS_ONLN);    //one thread per cpu, counting this one
+    if (numWorkers < 1)
+        numWorkers = 1;
+    if (numWorkers > MAX_WORKERS)
+        numWorkers = MAX_WORKERS;
+    if (numWorkers > numDirs)
+        numWorkers = numDirs;
+
+    for (i = 0; i < numWorkers - 1; i++) {    //start the other workers
+        if (pthread_create(&workers[i], NULL, validateWorker, &job) != 0)    //if no more threads, carry on with fewer
+            break;
+        started++;
+    }
+    validateWorker(&job);    //this thread works too, and takes whatever the others don't
+    for (i = 0; i < started; i++)    //wait for all of them to finish
+        pthread_join(workers[i], NULL);
+
+    for (i = 0; i < numDirs; i++) {    //print reports in the order directories were given
+        if (!job.reports[i].checked) {    //never pass a maze nobody looked at
+            printf("%s: not checked\n", dirs[i]);
+            invalid++;
+        } else if (job.reports[i].violations > 0) {
+            fwrite(job.reports[i].text, 1, job.reports[i].length, stdout);
+            invalid++;
+        }
+        free(job.reports[i].text);
+    }
+    free(job.reports);
+
+    printf("%d of %d mazes valid\n", numDirs - invalid, numDirs);
+
+    if (found) {    //free directory names we looked up
+        for (i = 0; i < numDirs; i++)
+            free(dirs[i]);
+        free(dirs);
+    }
+
+    return invalid > 0;
 }